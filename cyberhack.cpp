@@ -6,6 +6,7 @@
 #include "hack.h"
 #include "log.h"
 #include "problem.h"
+#include "replay.h"
 
 #include <optional>
 
@@ -60,6 +61,10 @@ mainMenuBar() noexcept
         };
         dear::Menu("Debug", true) && [] {
             gLogger.DrawShowMenuOption();
+            const bool wasRecording = gTraceViewer.record_;
+            gTraceViewer.DrawShowMenuOption();
+            if (gTraceViewer.record_ && !wasRecording)
+                sChanged = true;
         };
     };
 }
@@ -85,45 +90,104 @@ drawOptions() noexcept
     }
 }
 
+// RenderModel caches everything solveProblem draws that only changes when the
+// problem is re-solved, so an idle frame is a straight copy into ImGui.
+struct RenderModel final
+{
+    // Arrow joining two consecutive steps, with each point relative to the
+    // screen position of the cell it is anchored to.
+    struct Arrow final
+    {
+        ImVec2 start_;               // relative to the 'from' cell
+        ImVec2 end_, left_, right_;  // relative to the 'to' cell
+    };
+
+    size_t         dim_{0};
+    char           labels_[maxDim][maxDim][4]{};
+    int            steps_[maxDim][maxDim]{};
+    char           stepLabels_[maxDim * maxDim][8]{};
+    vector<Arrow>  arrows_{};
+    vector<ImVec2> positions_{};
+
+    void rebuild(const Hack& hack, bool solved) noexcept;
+};
+
+static RenderModel sRenderModel{};
+static bool        sRenderDirty{true};
+
+static ImVec2
+offsetBy(ImVec2 pos, ImVec2 offset) noexcept
+{
+    return ImVec2(pos.x + offset.x, pos.y + offset.y);
+}
+
 void
-drawOrder(const vector<ImVec2>& steps)
+RenderModel::rebuild(const Hack& hack, bool solved) noexcept
 {
     static const ImVec2    StartOffset(8.0f, 20.0f);
     static const ImVec2    EndOffset(8.0f, 20.0f);
-    static constexpr float ArrowLen      = 3.0f;
-    static constexpr float LineThickness = 1.0f;
-    static constexpr auto  LineColor     = IM_COL32(255, 120, 80, 160);
-    static constexpr auto  HeadColor     = IM_COL32(255, 110, 70, 120);
+    static constexpr float ArrowLen = 3.0f;
+
+    dim_ = hack.matrix_.empty() ? 0 : hack.matrixDim();
+    arrows_.clear();
+    positions_.clear();
+    for (auto& row : steps_)
+        std::fill(std::begin(row), std::end(row), -1);
+
+    const size_t rows = std::min(dim_, maxDim);
+    for (size_t y = 0; y < rows; y++) {
+        for (size_t x = 0; x < rows; x++)
+            snprintf(labels_[y][x], sizeof(labels_[y][x]), "%02X", hack.matrix_[y][x]);
+    }
 
-    if (steps.empty())
+    if (!solved)
         return;
 
-    ImDrawList* drawList = ImGui::GetWindowDrawList();
-    for (size_t i = 0; i < steps.size() - 1; i++) {
-        auto start = steps[i], end = steps[i + 1];
-        start.x += StartOffset.x;
-        start.y += StartOffset.y;
-        end.x += EndOffset.x;
-        end.y += EndOffset.y;
-        ImVec2 arrowLeft, arrowRight;
-        if (end.x != start.x) {
+    const auto& solution = hack.winner_.sequence_;
+    for (size_t i = 0; i < solution.size() && i < std::size(stepLabels_); i++) {
+        const auto& point = solution[i];
+        if (point.x_ < rows && point.y_ < rows)
+            steps_[point.y_][point.x_] = static_cast<int>(i);
+        snprintf(stepLabels_[i], sizeof(stepLabels_[i]), "  %zu", i + 1);
+    }
+    positions_.resize(solution.size());
+
+    for (size_t i = 0; i + 1 < solution.size(); i++) {
+        const auto& from = solution[i];
+        const auto& to   = solution[i + 1];
+        Arrow       arrow{StartOffset, EndOffset, {}, {}};
+        if (to.x_ != from.x_) {
             // horizontal
-            float xfac = end.x < start.x ? -1.0f : 1.0f;
-            start.x += xfac * 2.f;
-            end.x -= xfac * 2.f;
-            arrowLeft.x  = end.x - xfac * ArrowLen;
-            arrowLeft.y  = end.y + ArrowLen;
-            arrowRight.x = end.x - xfac * ArrowLen;
-            arrowRight.y = end.y - ArrowLen;
+            float xfac = to.x_ < from.x_ ? -1.0f : 1.0f;
+            arrow.start_.x += xfac * 2.f;
+            arrow.end_.x -= xfac * 2.f;
+            arrow.left_  = ImVec2(arrow.end_.x - xfac * ArrowLen, arrow.end_.y + ArrowLen);
+            arrow.right_ = ImVec2(arrow.end_.x - xfac * ArrowLen, arrow.end_.y - ArrowLen);
         } else {
-            float yfac = end.y < start.y ? -1.0f : 1.0f;
-            start.y -= yfac * 2.f;
-            end.y += yfac * 2.f;
-            arrowLeft.x  = end.x + ArrowLen;
-            arrowLeft.y  = end.y - yfac * ArrowLen;
-            arrowRight.x = end.x - ArrowLen;
-            arrowRight.y = end.y - yfac * ArrowLen;
+            float yfac = to.y_ < from.y_ ? -1.0f : 1.0f;
+            arrow.start_.y -= yfac * 2.f;
+            arrow.end_.y += yfac * 2.f;
+            arrow.left_  = ImVec2(arrow.end_.x + ArrowLen, arrow.end_.y - yfac * ArrowLen);
+            arrow.right_ = ImVec2(arrow.end_.x - ArrowLen, arrow.end_.y - yfac * ArrowLen);
         }
+        arrows_.push_back(arrow);
+    }
+}
+
+void
+drawOrder(const RenderModel& model)
+{
+    static constexpr float LineThickness = 1.0f;
+    static constexpr auto  LineColor     = IM_COL32(255, 120, 80, 160);
+    static constexpr auto  HeadColor     = IM_COL32(255, 110, 70, 120);
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    for (size_t i = 0; i < model.arrows_.size(); i++) {
+        const auto& arrow      = model.arrows_[i];
+        const auto  start      = offsetBy(model.positions_[i], arrow.start_);
+        const auto  end        = offsetBy(model.positions_[i + 1], arrow.end_);
+        const auto  arrowLeft  = offsetBy(model.positions_[i + 1], arrow.left_);
+        const auto  arrowRight = offsetBy(model.positions_[i + 1], arrow.right_);
         drawList->AddLine(end, arrowLeft, HeadColor, LineThickness);
         drawList->AddLine(arrowLeft, arrowRight, HeadColor, LineThickness);
         drawList->AddLine(arrowRight, end, HeadColor, LineThickness);
@@ -155,34 +219,31 @@ solveProblem(ImVec2 size, const Hack& hack) noexcept
 {
     constexpr ImGuiTableFlags tableFlags{ImGuiTableFlags_SizingStretchSame |
                                          ImGuiTableFlags_Borders};
+    if (sRenderDirty) {
+        sRenderModel.rebuild(hack, sSolved);
+        sRenderDirty = false;
+    }
+
     dear::Table("#problem", maxDim, tableFlags, size, 0) && [&]() {
-        if (hack.matrix_.empty())
+        auto& model = sRenderModel;
+        if (model.dim_ == 0)
             return;
-        const float  TEXT_BASE_HEIGHT = ImGui::GetTextLineHeightWithSpacing() * 2;
-        const auto&  solution         = hack.winner_.sequence_;
-        const size_t dim              = hack.matrixDim();
-        char         value[16];
-
-        vector<ImVec2> steps{};
-        steps.resize(solution.size());
+        const float TEXT_BASE_HEIGHT = ImGui::GetTextLineHeightWithSpacing() * 2;
 
         for (size_t y = 0; y < maxDim; y++) {
             ImGui::TableNextRow(ImGuiTableRowFlags_None, TEXT_BASE_HEIGHT);
-            for (size_t x = 0; x < dim; x++) {
+            for (size_t x = 0; x < model.dim_; x++) {
                 if (ImGui::TableNextColumn()) {
-                    if (y < dim && x < maxDim) {
-                        ImVec2 here = ImGui::GetCursorScreenPos();
-                        snprintf(value, sizeof(value), "%02X", hack.matrix_[y][x]);
-                        auto       stepNo   = solution.find(Point{x, y});
-                        const bool selected = sSolved && stepNo.has_value();
+                    if (y < model.dim_ && x < maxDim) {
+                        const int  stepNo   = model.steps_[y][x];
+                        const bool selected = stepNo >= 0;
+                        if (selected)
+                            model.positions_[stepNo] = ImGui::GetCursorScreenPos();
                         dear::WithStyleVar(ImGuiStyleVar_SelectableTextAlign, ImVec2(0.5f, 0.5f)) &&
                             [&]() {
-                                dear::Selectable(value, selected);
-                                if (selected) {
-                                    steps[stepNo.value()] = here;
-                                    snprintf(value, sizeof(value), "  %zu", stepNo.value() + 1);
-                                    ImGui::Text(value);
-                                }
+                                dear::Selectable(model.labels_[y][x], selected);
+                                if (selected)
+                                    ImGui::TextUnformatted(model.stepLabels_[stepNo]);
                             };
                     } else {
                         dear::Text("");
@@ -191,7 +252,7 @@ solveProblem(ImVec2 size, const Hack& hack) noexcept
             }
         }
 
-        drawOrder(steps);
+        drawOrder(model);
     };
 }
 
@@ -249,8 +310,11 @@ void
 refreshProblem(Hack& hack)
 {
     sSolutionError.what_.clear();
-    sSolved  = false;
-    sChanged = false;
+    sSolved      = false;
+    sChanged     = false;
+    sRenderDirty = true;
+
+    hack.trace_ = gTraceViewer.BeginRecording();
     try {
         hack.populate(sProblem, sGoals);
         hack.solve(sBufferSize);
@@ -259,6 +323,7 @@ refreshProblem(Hack& hack)
         sSolutionError.what_ = e.what_;
         ImGui::OpenPopup("WHOOPS");
     }
+    gTraceViewer.EndRecording();
 }
 
 int
@@ -302,6 +367,7 @@ main(int argc, const char* argv[])
         };
 
         gLogger.Draw();
+        gTraceViewer.Draw();
 
         if (!sSolutionError.what_.empty()) {
             if (ImGui::BeginPopup("WHOOPS")) {
@@ -6,73 +6,297 @@
 #include "error.h"
 #include "log.h"
 
+#include <bit>
 #include <numeric>
+#include <utility>
 
-void
-Hack::populate(std::string_view matrix, std::string_view goals) noexcept(false)
+size_t
+ParseCache::parse(std::string_view text, Matrix& into) noexcept(false)
 {
-    constexpr auto populateMatrix = [](std::string_view text, Matrix& into) {
-        bool needRow{true};
-        while (!text.empty()) {
-            if (isspace(text.front()) || text.front() == 0)
-                text.remove_prefix(1);
-            else {
-                uint8_t byte{0};
-                if (auto [_, ec] = std::from_chars(text.data(), text.data() + 2, byte, 16);
-                    ec != std::errc())
-                    throw Error("Unable to read matrix");
-                text.remove_prefix(2);
-                if (needRow)
-                    into.resize(into.size() + 1);
-                into.back().push_back(byte);
-                needRow = (!text.empty() && text.front() == '\n');
+    constexpr auto parseRow = [](std::string_view line, Row& row) {
+        while (!line.empty()) {
+            if (isspace(line.front()) || line.front() == 0) {
+                line.remove_prefix(1);
+                continue;
             }
+            const size_t len = std::min<size_t>(line.size(), 2);
+            uint8_t      byte{0};
+            if (auto [_, ec] = std::from_chars(line.data(), line.data() + len, byte, 16);
+                ec != std::errc())
+                throw Error("Unable to read matrix");
+            line.remove_prefix(len);
+            row.push_back(byte);
         }
     };
 
-    matrix_.clear();
-    goals_.clear();
+    into.clear();
+
+    size_t reparsed{0}, lineNo{0};
+    for (; !text.empty(); lineNo++) {
+        const auto       eol  = text.find('\n');
+        std::string_view line = text.substr(0, eol);
+        text.remove_prefix(eol == text.npos ? text.size() : eol + 1);
+
+        if (lineNo < lines_.size() && lines_[lineNo] == line)
+            continue;
+
+        Row row{};
+        parseRow(line, row);
+        ++reparsed;
+        if (lineNo < lines_.size()) {
+            lines_[lineNo] = line;
+            rows_[lineNo]  = std::move(row);
+        } else {
+            lines_.emplace_back(line);
+            rows_.emplace_back(std::move(row));
+        }
+    }
+    lines_.resize(lineNo);
+    rows_.resize(lineNo);
+
+    for (const auto& row : rows_) {
+        if (!row.empty())
+            into.push_back(row);
+    }
+
+    return reparsed;
+}
+
+void
+Hack::populate(std::string_view matrix, std::string_view goals) noexcept(false)
+{
     matches_.clear();
 
-    if (matrix.empty())
-        throw Error("Please input a problem matrix first.");
-    if (goals.empty())
-        throw Error("Please input a goals matrix first.");
+    try {
+        if (matrix.empty())
+            throw Error("Please input a problem matrix first.");
+        if (goals.empty())
+            throw Error("Please input a goals matrix first.");
+
+        const size_t rowsParsed = matrixCache_.parse(matrix, matrix_);
+        if (matrix_.empty())
+            throw Error("Please input a problem matrix first.");
+
+        // Make sure the matrix is regular.
+        const size_t matrixDim = matrix_.size();
+        for (const auto& row : matrix_) {
+            if (row.size() != matrixDim)
+                throw Error("Matrix is irregular");
+        }
+        if (matrixDim > MaxMatrixDim)
+            throw Error("Matrix is too large");
+
+        const size_t goalsParsed = goalsCache_.parse(goals, goals_);
+
+        Log("reparsed ", rowsParsed, " matrix and ", goalsParsed, " goal lines\n");
+    } catch (const Error&) {
+        // Don't leave the previous puzzle behind for the GUI to draw.
+        matrix_.clear();
+        goals_.clear();
+        throw;
+    }
+}
 
-    populateMatrix(matrix, matrix_);
+void
+Hack::analyse(size_t bufferSize) noexcept(false)
+{
+    const size_t dim = matrixDim();
 
-    // Make sure the matrix is regular.
-    const size_t matrixDim = matrix_.size();
+    symbolIds_.fill(NoSymbol);
+    symbols_ = 0;
     for (const auto& row : matrix_) {
-        if (row.size() != matrixDim)
-            throw Error("Matrix is irregular");
+        for (const auto byte : row) {
+            if (symbolIds_[byte] == NoSymbol)
+                symbolIds_[byte] = static_cast<uint16_t>(symbols_++);
+        }
+    }
+
+    rowSymbols_.assign(dim * symbols_, 0);
+    colSymbols_.assign(dim * symbols_, 0);
+    for (size_t y = 0; y < dim; y++) {
+        for (size_t x = 0; x < dim; x++) {
+            const auto id = symbolIds_[matrix_[y][x]];
+            rowSymbols_[y * symbols_ + id] |= uint64_t(1) << x;
+            colSymbols_[x * symbols_ + id] |= uint64_t(1) << y;
+        }
     }
 
-    populateMatrix(goals, goals_);
+    // Consecutive goal bytes must be able to share a row or column, on
+    // distinct cells if they are the same byte.
+    const auto canFollow = [&](uint8_t from, uint8_t to) {
+        for (const bool vertical : {false, true}) {
+            for (size_t line = 0; line < dim; line++) {
+                const uint64_t fromMask = lineMask(vertical, line, from);
+                const uint64_t toMask   = lineMask(vertical, line, to);
+                if (fromMask && toMask && (from != to || std::popcount(fromMask) > 1))
+                    return true;
+            }
+        }
+        return false;
+    };
+
+    goalStatus_.assign(goals_.size(), GoalStatus::Feasible);
+    active_.clear();
+    for (size_t i = 0; i < goals_.size(); i++) {
+        const auto& goal = goals_[i];
+        if (std::any_of(goal.cbegin(), goal.cend(),
+                        [&](uint8_t byte) { return symbolIds_[byte] == NoSymbol; })) {
+            goalStatus_[i] = GoalStatus::Impossible;
+            Log("goal ", i + 1, " uses a byte not in the matrix\n");
+            continue;
+        }
+        if (std::adjacent_find(goal.cbegin(), goal.cend(), [&](uint8_t from, uint8_t to) {
+                return !canFollow(from, to);
+            }) != goal.cend()) {
+            goalStatus_[i] = GoalStatus::Impossible;
+            Log("goal ", i + 1, " has bytes that never share a row or column\n");
+            continue;
+        }
+
+        // The first move is always in row 0, so a goal starting elsewhere
+        // needs one move to get there.
+        const size_t minMoves = goal.size() + (lineMask(false, 0, goal[0]) ? 0 : 1);
+        if (minMoves > bufferSize) {
+            goalStatus_[i] = GoalStatus::Unreachable;
+            Log("goal ", i + 1, " needs ", minMoves, " moves, more than the buffer\n");
+        } else {
+            active_.push_back(i);
+        }
+    }
+
+    if (active_.empty())
+        throw Error("None of the goals can be completed.");
+}
+
+size_t
+Hack::evaluate(const Sequence& sequence, size_t bufferSize) noexcept
+{
+    size_t completed{0};
+    for (const auto i : active_) {
+        matches_[i] = testPattern(goals_[i], sequence, bufferSize);
+        if (matches_[i] == goals_[i].size())
+            ++completed;
+    }
+    return completed;
+}
+
+bool
+Hack::bounded(size_t completed, size_t length) const noexcept
+{
+    const size_t remaining = bufferSize_ - length;
+
+    // Each further move can advance an incomplete goal by at most one byte,
+    // whether it continues the current match or starts over.
+    size_t maxCompleted{completed};
+    for (const auto goal : active_) {
+        const size_t needed = goals_[goal].size() - matches_[goal];
+        if (needed > 0 && needed <= remaining)
+            ++maxCompleted;
+    }
+    if (maxCompleted == 0)
+        return true;
+    if (reportAt_ > 0 && maxCompleted >= reportAt_)
+        return false;
+    if (maxCompleted != winner_.completed_)
+        return maxCompleted < winner_.completed_;
+
+    // Equal goal counts come down to score: the best any extension by 'k'
+    // moves can do is gain one match per incomplete goal per move, less the
+    // buffer the moves use.
+    const size_t matched = std::accumulate(matches_.cbegin(), matches_.cend(), size_t(0));
+    size_t       bestGain{0};
+    for (size_t k = 1; k <= remaining; k++) {
+        size_t gain{0};
+        for (const auto goal : active_)
+            gain += std::min(goals_[goal].size() - matches_[goal], k);
+        if (gain > k)
+            bestGain = std::max(bestGain, gain - k);
+    }
+    const size_t maxScore = bufferSize_ - length + matched + bestGain;
+    if (maxScore != winner_.score_)
+        return maxScore < winner_.score_;
+    // A tie only wins by being shorter.
+    return length >= winner_.sequence_.size();
 }
 
 void
-Hack::solve(const size_t bufferSize) noexcept(false)
+Hack::warmStart(Result&& previous, size_t bufferSize) noexcept
 {
+    auto& sequence = previous.sequence_;
+    if (sequence.empty() || sequence.size() > bufferSize)
+        return;
+    for (const auto& point : sequence) {
+        if (point.x_ >= matrixDim() || point.y_ >= matrixDim())
+            return;
+    }
+
+    const size_t completed = evaluate(sequence, bufferSize);
+    if (completed == 0)
+        return;
+
+    size_t score =
+        std::accumulate(matches_.cbegin(), matches_.cend(), bufferSize - sequence.size());
+    Log("warm start: completed: ", completed, ", score: ", score, ", len: ", sequence.size(),
+        "\n");
+    winner_ = Result{std::move(sequence), matches_, completed, score};
+}
+
+void
+Hack::start(const size_t bufferSize, const size_t reportAt) noexcept(false)
+{
+    stop();
+
+    bufferSize_ = bufferSize;
+    reportAt_   = reportAt;
     opened_.clear();
     opened_.reserve(bufferSize * bufferSize);
     matches_.clear();
     matches_.resize(goals_.size());
-    winner_ = Result{};
+    analyse(bufferSize);
+    // A traced search starts cold, so the replay contains every winner that
+    // shaped it; so does one reporting every sequence that reaches reportAt,
+    // which would otherwise skip the improvements leading up to the winner.
+    if (trace_ || reportAt != 0)
+        winner_ = Result{};
+    else
+        warmStart(std::exchange(winner_, Result{}), bufferSize);
+    warmStarted_ = winner_.completed_ > 0;
+    if (trace_)
+        trace_->begin(matrix_, goals_, bufferSize);
 
     for (size_t i = 0; i < matrixDim(); i++)
         opened_.emplace_back(Candidate{{i, 0}, {}});
+}
+
+void
+Hack::stop() noexcept
+{
+    opened_.clear();
+    warmStarted_ = false;
+    if (trace_)
+        trace_->end();
+}
+
+const Result*
+Hack::next() noexcept(false)
+{
+    const size_t bufferSize = bufferSize_;
+
+    // The re-scored previous winner is the first improvement we know of.
+    if (std::exchange(warmStarted_, false))
+        return &winner_;
 
     while (!opened_.empty()) {
         auto [target, sequence] = opened_.back();
         opened_.pop_back();
         sequence.push_back(target);
 
-        size_t completed{0};
-        for (size_t i = 0; i < matches_.size(); i++) {
-            matches_[i] = testPattern(goals_[i], sequence, bufferSize);
-            if (matches_[i] == goals_[i].size())
-                ++completed;
+        const size_t  completed = evaluate(sequence, bufferSize);
+        const Result* report{nullptr};
+
+        if (bounded(completed, sequence.size())) {
+            trace(TraceEvent::Prune, sequence);
+            continue;
         }
 
         if (completed) {
@@ -105,15 +329,48 @@ Hack::solve(const size_t bufferSize) noexcept(false)
                 }
 
                 winner_ = Result{sequence, matches_, completed, score};
+                trace(TraceEvent::Winner, sequence);
+                report = &winner_;
+            } else if (reportAt_ > 0 && completed >= reportAt_) {
+                found_ = Result{sequence, matches_, completed, score};
+                report = &found_;
             }
         }
 
-        if (sequence.size() == bufferSize || completed == goals_.size())
-            continue;
+        if (sequence.size() == bufferSize || completed == active_.size()) {
+            trace(TraceEvent::Leaf, sequence);
+        } else {
+            trace(TraceEvent::Expand, sequence);
+            expand(target, sequence);
+        }
+
+        if (report)
+            return report;
+    }
+
+    stop();
+    return nullptr;
+}
+
+void
+Hack::expand(Point target, const Sequence& sequence)
+{
+    // each odd - numbered turn is vertical, even - numbered horizontal
+    bool         verticalMove = (sequence.size() & 1) == 1;
+    const size_t line         = verticalMove ? target.x_ : target.y_;
 
-        // each odd - numbered turn is vertical, even - numbered horizontal
-        bool verticalMove = (sequence.size() & 1) == 1;
-        for (size_t i = 0; i < matrixDim(); i++) {
+    // Queue moves onto a byte that advances some goal last, so they are
+    // explored first and a strong winner is found early.
+    uint64_t wanted{0};
+    for (const auto goal : active_) {
+        if (matches_[goal] < goals_[goal].size())
+            wanted |= lineMask(verticalMove, line, goals_[goal][matches_[goal]]);
+    }
+    const size_t   dim   = matrixDim();
+    const uint64_t every = dim < 64 ? (uint64_t(1) << dim) - 1 : ~uint64_t(0);
+    for (uint64_t moves : {every & ~wanted, wanted}) {
+        for (; moves; moves &= moves - 1) {
+            const size_t i = std::countr_zero(moves);
             if (verticalMove)
                 target.y_ = i;
             else
@@ -123,6 +380,21 @@ Hack::solve(const size_t bufferSize) noexcept(false)
                 opened_.emplace_back(target, sequence);
         }
     }
+}
+
+Solutions
+Hack::solutions(const size_t bufferSize, const size_t reportAt) noexcept(false)
+{
+    start(bufferSize, reportAt);
+    return Solutions{*this};
+}
+
+void
+Hack::solve(const size_t bufferSize) noexcept(false)
+{
+    start(bufferSize);
+    while (next() != nullptr) {
+    }
 
     if (winner_.completed_ == 0)
         throw Error("No solution found.");
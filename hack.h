@@ -4,20 +4,107 @@
 #pragma once
 
 #include "cyberhack.h"
+#include "trace.h"
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <string>
+
+// ParseCache remembers the text each row of a matrix was parsed from, so that
+// an edit only has to reparse the lines that actually changed.
+struct ParseCache final
+{
+    vector<std::string> lines_{};
+    Matrix              rows_{};
+
+    // Parses 'text' into 'into', returning how many lines were (re)parsed.
+    size_t parse(std::string_view text, Matrix& into) noexcept(false);
+};
+
+// GoalStatus is what the pre-search analysis concluded about a goal.
+enum class GoalStatus : uint8_t
+{
+    Feasible,
+    Unreachable,  // needs more moves than the buffer holds
+    Impossible,   // can never be entered in this matrix
+};
+
+struct Solutions;
 
 struct Hack
 {
+    // Occurrence masks are 64 bits wide, one bit per row or column.
+    static constexpr size_t MaxMatrixDim = 64;
+
     Matrix matrix_{};
     Matrix goals_{};
 
     Result winner_{};
 
+    vector<GoalStatus> goalStatus_{};
+
+    // When set, solve() records its search into this trace.
+    SearchTrace* trace_{nullptr};
+
 protected:
     using OpenSet    = vector<Candidate>;
     using MatchCount = vector<size_t>;
 
     OpenSet    opened_{};
     MatchCount matches_{};
+    ParseCache matrixCache_{};
+    ParseCache goalsCache_{};
+
+    // Symbol occurrence indices built by analyse(): each distinct matrix byte
+    // gets a dense id, and for every row (column) and id there is a mask of
+    // the columns (rows) holding that byte.
+    static constexpr uint16_t NoSymbol = 0x100;
+    std::array<uint16_t, 256> symbolIds_{};
+    size_t                    symbols_{0};
+    vector<uint64_t>          rowSymbols_{};
+    vector<uint64_t>          colSymbols_{};
+    vector<size_t>            active_{};
+
+    // State of the search in progress between calls to next().
+    size_t bufferSize_{0};
+    size_t reportAt_{0};
+    bool   warmStarted_{false};
+    Result found_{};
+
+    // Indexes the matrix and classifies each goal, leaving the feasible ones
+    // in active_ for the search.
+    void analyse(size_t bufferSize) noexcept(false);
+
+    // Mask of the cells along a column (vertical) or row holding 'byte'.
+    uint64_t lineMask(bool vertical, size_t line, uint8_t byte) const noexcept
+    {
+        const auto id = symbolIds_[byte];
+        if (id == NoSymbol)
+            return 0;
+        return (vertical ? colSymbols_ : rowSymbols_)[line * symbols_ + id];
+    }
+
+    // Scores 'sequence' against every active goal into matches_, returning
+    // how many goals it completes.
+    size_t evaluate(const Sequence& sequence, size_t bufferSize) noexcept;
+
+    // True when neither the node just evaluated into matches_ nor anything
+    // reached from it can beat winner_ (or reach reportAt_).
+    bool bounded(size_t completed, size_t length) const noexcept;
+
+    // Re-scores the previous winner against the current puzzle so the search
+    // starts with it as the result to beat.
+    void warmStart(Result&& previous, size_t bufferSize) noexcept;
+
+    // Queues the moves that follow 'sequence', which ends at 'target'.
+    void expand(Point target, const Sequence& sequence);
+
+    void trace(TraceEvent event, const Sequence& sequence) noexcept
+    {
+        if (trace_ && trace_->recording())
+            trace_->record(event, sequence.size(), sequence.back());
+    }
 
 public:
     Hack()
@@ -28,6 +115,24 @@ public:
 
     void populate(std::string_view matrix, std::string_view goals) noexcept(false);
 
+    // Begins a search that next() advances. Each improvement on the winner is
+    // reported; with a non-zero 'reportAt' so is every other sequence that
+    // completes at least that many goals.
+    void start(const size_t bufferSize, const size_t reportAt = 0) noexcept(false);
+
+    // Runs the search until it has something to report, returning nullptr
+    // once the search is exhausted. The result is only valid until the next
+    // call.
+    const Result* next() noexcept(false);
+
+    // Abandons the search in progress.
+    void stop() noexcept;
+
+    // Starts a search and returns it as a range that pulls results as it is
+    // iterated; leaving the loop early ends the search.
+    Solutions solutions(const size_t bufferSize, const size_t reportAt = 0) noexcept(false);
+
+    // Runs a search to completion, leaving the best result in winner_.
     void solve(const size_t bufferSize) noexcept(false);
 
     size_t matrixDim() const noexcept { return matrix_[0].size(); }
@@ -49,3 +154,40 @@ public:
         return progress;
     }
 };
+
+// Solutions is an input range over the results of a search in progress.
+struct Solutions final
+{
+    struct iterator final
+    {
+        using difference_type = std::ptrdiff_t;
+        using value_type      = Result;
+
+        Hack*         hack_{nullptr};
+        const Result* result_{nullptr};
+
+        const Result& operator*() const noexcept { return *result_; }
+        const Result* operator->() const noexcept { return result_; }
+
+        iterator& operator++() noexcept(false)
+        {
+            result_ = hack_->next();
+            return *this;
+        }
+        void operator++(int) noexcept(false) { ++*this; }
+
+        bool operator==(std::default_sentinel_t) const noexcept { return result_ == nullptr; }
+    };
+
+    explicit Solutions(Hack& hack) noexcept : hack_{hack} {}
+    ~Solutions() { hack_.stop(); }
+
+    Solutions(const Solutions&) = delete;
+    Solutions& operator=(const Solutions&) = delete;
+
+    iterator                begin() noexcept(false) { return iterator{&hack_, hack_.next()}; }
+    std::default_sentinel_t end() const noexcept { return {}; }
+
+private:
+    Hack& hack_;
+};
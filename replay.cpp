@@ -0,0 +1,187 @@
+// CyberPunk ICE/Hack solver
+// Copyright (C) Oliver "kfsone" Smith <oliver@kfs.org> 2021
+
+#include "replay.h"
+#include "error.h"
+
+#include "imguiwrap.dear.h"
+
+#include <utility>
+
+TraceViewer gTraceViewer{};
+
+static constexpr const char* EventNames[] = {"Expand", "Leaf", "Prune", "Winner"};
+
+SearchTrace*
+TraceViewer::BeginRecording() noexcept
+{
+    recording_ = record_;
+    if (!recording_)
+        return nullptr;
+    recorder_.reset();
+    return &recorder_;
+}
+
+void
+TraceViewer::EndRecording() noexcept
+{
+    if (!std::exchange(recording_, false))
+        return;
+    recorder_.end();
+    if (recorder_.recorded()) {
+        Load();
+    } else {
+        Clear();
+        error_ = "The last solve was not traced; see the log.";
+    }
+}
+
+void
+TraceViewer::Clear() noexcept
+{
+    trace_ = TraceFile{};
+    error_.clear();
+    step_         = 0;
+    sequenceStep_ = -1;
+}
+
+void
+TraceViewer::Load() noexcept
+{
+    Clear();
+    try {
+        trace_.load(recorder_.path());
+    } catch (const Error& e) {
+        trace_ = TraceFile{};
+        error_ = e.what_;
+    }
+}
+
+void
+TraceViewer::Draw() noexcept
+{
+    if (!open_)
+        return;
+
+    static constexpr ImGuiWindowFlags TraceWindowFlags{ImGuiWindowFlags_None};
+
+    ImGui::SetNextWindowSize(ImVec2(440, 520), ImGuiCond_FirstUseEver);
+    dear::Begin("Trace Replay", &open_, TraceWindowFlags) && [&] {
+        if (!error_.empty()) {
+            dear::Text(error_);
+            return;
+        }
+        if (trace_.size() == 0) {
+            dear::Text("No trace recorded: enable Debug > Record Trace and solve.");
+            return;
+        }
+
+        const int last = static_cast<int>(trace_.size()) - 1;
+        if (ImGui::Button("<") && step_ > 0)
+            --step_;
+        ImGui::SameLine();
+        if (ImGui::Button(">") && step_ < last)
+            ++step_;
+        ImGui::SameLine();
+        if (ImGui::Button("Next Winner")) {
+            for (int i = step_ + 1; i <= last; i++) {
+                if (trace_.step(i).event_ == TraceEvent::Winner) {
+                    step_ = i;
+                    break;
+                }
+            }
+        }
+        ImGui::SliderInt("Step", &step_, 0, last, "%d", ImGuiSliderFlags_AlwaysClamp);
+
+        if (sequenceStep_ != step_) {
+            sequence_     = trace_.sequenceAt(step_);
+            sequenceStep_ = step_;
+        }
+        const auto step = trace_.step(step_);
+        ImGui::Text("%s at depth %zu of %zu", EventNames[static_cast<size_t>(step.event_)],
+                    step.depth_, trace_.bufferSize_);
+
+        DrawGrid();
+        ImGui::NewLine();
+        DrawHeatMap();
+    };
+}
+
+void
+TraceViewer::DrawGrid() noexcept
+{
+    constexpr ImGuiTableFlags tableFlags{ImGuiTableFlags_SizingStretchSame |
+                                         ImGuiTableFlags_Borders};
+    const size_t dim = trace_.matrix_.size();
+    if (dim == 0)
+        return;
+
+    // Shade each cell by how many nodes at the current depth landed on it.
+    const auto&  heat    = trace_.cellsByDepth_[trace_.step(step_).depth_];
+    const size_t hottest = std::max<size_t>(*std::max_element(heat.cbegin(), heat.cend()), 1);
+
+    dear::Table("#tracegrid", static_cast<int>(dim), tableFlags, ImVec2(0, 0), 0) && [&]() {
+        char value[16];
+        for (size_t y = 0; y < dim; y++) {
+            ImGui::TableNextRow();
+            for (size_t x = 0; x < dim; x++) {
+                if (!ImGui::TableNextColumn())
+                    continue;
+                const auto alpha = static_cast<int>(160 * heat[y * dim + x] / hottest);
+                ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, IM_COL32(255, 120, 80, alpha));
+
+                const auto stepNo = sequence_.find(Point{x, y});
+                if (stepNo.has_value())
+                    snprintf(value, sizeof(value), "%02X %zu", trace_.matrix_[y][x],
+                             stepNo.value() + 1);
+                else
+                    snprintf(value, sizeof(value), "%02X", trace_.matrix_[y][x]);
+                dear::WithStyleVar(ImGuiStyleVar_SelectableTextAlign, ImVec2(0.5f, 0.5f)) &&
+                    [&]() {
+                        dear::Selectable(value, stepNo.has_value());
+                    };
+            }
+        }
+    };
+}
+
+void
+TraceViewer::DrawHeatMap() noexcept
+{
+    constexpr ImGuiTableFlags tableFlags{ImGuiTableFlags_SizingStretchProp |
+                                         ImGuiTableFlags_Borders};
+
+    size_t total{0};
+    for (const auto& counts : trace_.eventsByDepth_)
+        total += counts[0] + counts[1] + counts[2];
+    total = std::max<size_t>(total, 1);
+
+    dear::Table("#traceheat", 6, tableFlags, ImVec2(0, 0), 0) && [&]() {
+        ImGui::TableSetupColumn("Depth");
+        for (const auto* name : EventNames)
+            ImGui::TableSetupColumn(name);
+        ImGui::TableSetupColumn("Budget");
+        ImGui::TableHeadersRow();
+
+        for (size_t depth = 1; depth < trace_.eventsByDepth_.size(); depth++) {
+            const auto&  counts = trace_.eventsByDepth_[depth];
+            const size_t nodes  = counts[0] + counts[1] + counts[2];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu", depth);
+            for (const auto count : counts) {
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", count);
+            }
+            ImGui::TableNextColumn();
+            ImGui::ProgressBar(static_cast<float>(nodes) / total, ImVec2(-1.0f, 0.0f));
+        }
+    };
+}
+
+void
+TraceViewer::DrawShowMenuOption() noexcept
+{
+    dear::MenuItem("Record Trace", &record_);
+    dear::MenuItem("Show Trace Replay", &open_);
+}
@@ -0,0 +1,49 @@
+// CyberPunk ICE/Hack solver
+// Copyright (C) Oliver "kfsone" Smith <oliver@kfs.org> 2021
+
+#pragma once
+
+#include <string>
+
+#include "trace.h"
+
+// TraceViewer owns the search recorder and replays what it recorded.
+struct TraceViewer final
+{
+    TraceViewer() noexcept {}
+
+    // Returns the recorder to trace the next solve with, or nullptr when
+    // recording is off.
+    SearchTrace* BeginRecording() noexcept;
+
+    // Loads what the solve recorded, or clears the replay if nothing was.
+    void EndRecording() noexcept;
+
+    // Loads the most recently recorded trace.
+    void Load() noexcept;
+
+    // Drops the loaded trace.
+    void Clear() noexcept;
+
+    void Draw() noexcept;
+
+    void DrawShowMenuOption() noexcept;
+
+protected:
+    void DrawGrid() noexcept;
+
+    void DrawHeatMap() noexcept;
+
+public:
+    bool        open_{false};
+    bool        record_{false};
+    bool        recording_{false};
+    SearchTrace recorder_{"cyberhack.trace"};
+    TraceFile   trace_{};
+    std::string error_{};
+    int         step_{0};
+    Sequence    sequence_{};
+    int         sequenceStep_{-1};
+};
+
+extern TraceViewer gTraceViewer;
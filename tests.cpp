@@ -51,4 +51,37 @@ const char* case2 =
     "55 BD 55 BD\n"
     "BD 55 BD 55\n"
     "1C FF FF 1C\n"
-    "88 E9 7A 88\n";
\ No newline at end of file
+    "88 E9 7A 88\n";
+// Every result a search yields, in the order it yields them.
+static vector<Sequence>
+collect(Hack& hack, const Problem& problem, size_t reportAt)
+{
+    vector<Sequence> sequences{};
+    try {
+        hack.populate(problem.matrix_, problem.goals_);
+        for (const Result& result : hack.solutions(problem.buffer_, reportAt))
+            sequences.push_back(result.sequence_);
+    } catch (const Error&) {
+    }
+    return sequences;
+}
+
+// Re-running a search on a Hack that already holds a winner must end on the
+// same winner as a cold run and, when reporting every sequence that reaches
+// 'reportAt', yield exactly the same results with no duplicates.
+static bool
+warmMatchesCold(const Problem& problem, size_t reportAt)
+{
+    Hack cold{};
+    Hack warm{};
+    collect(warm, problem, reportAt);
+
+    const auto expected = collect(cold, problem, reportAt);
+    const auto actual   = collect(warm, problem, reportAt);
+    if (expected.empty() || actual.empty())
+        return expected.empty() && actual.empty();
+    if (reportAt == 0)
+        return expected.back() == actual.back();
+    return std::is_permutation(expected.cbegin(), expected.cend(), actual.cbegin(),
+                               actual.cend());
+}
@@ -0,0 +1,140 @@
+// CyberPunk ICE/Hack solver
+// Copyright (C) Oliver "kfsone" Smith <oliver@kfs.org> 2021
+
+#include "trace.h"
+#include "error.h"
+#include "log.h"
+
+#include <memory>
+
+void
+SearchTrace::begin(const Matrix& matrix, const Matrix& goals, size_t bufferSize) noexcept
+{
+    reset();
+
+    if (matrix.size() > MaxDim || bufferSize > MaxDepth || goals.size() > 255) {
+        Log("Puzzle is too large to trace, solving without it.\n");
+        return;
+    }
+
+    file_ = fopen(path_.c_str(), "wb");
+    if (!file_) {
+        gLogger << "Unable to open trace file " << path_ << ", solving without it.\n";
+        return;
+    }
+    recorded_ = true;
+
+    fwrite(Magic, sizeof(Magic), 1, file_);
+    buffer_[used_++] = static_cast<uint8_t>(matrix.size());
+    buffer_[used_++] = static_cast<uint8_t>(bufferSize);
+    for (const auto& row : matrix) {
+        for (const auto& byte : row)
+            buffer_[used_++] = byte;
+    }
+    buffer_[used_++] = static_cast<uint8_t>(goals.size());
+    for (const auto& goal : goals) {
+        if (used_ + goal.size() + 1 > buffer_.size())
+            flush();
+        buffer_[used_++] = static_cast<uint8_t>(std::min<size_t>(goal.size(), 255));
+        for (size_t i = 0; i < goal.size() && i < 255; i++)
+            buffer_[used_++] = goal[i];
+    }
+}
+
+void
+SearchTrace::end() noexcept
+{
+    if (!file_)
+        return;
+    flush();
+    fclose(file_);
+    file_ = nullptr;
+}
+
+void
+SearchTrace::flush() noexcept
+{
+    if (file_ && used_)
+        fwrite(buffer_.data(), 1, used_, file_);
+    used_ = 0;
+}
+
+void
+TraceFile::load(const std::string& path) noexcept(false)
+{
+    *this = TraceFile{};
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        throw Error("Unable to open trace file " + path);
+    // Close the file however we leave.
+    std::unique_ptr<FILE, int (*)(FILE*)> closer{file, fclose};
+
+    const auto next = [&]() -> uint8_t {
+        const int byte = fgetc(file);
+        if (byte == EOF)
+            throw Error("Trace file is truncated");
+        return static_cast<uint8_t>(byte);
+    };
+
+    for (const char c : SearchTrace::Magic) {
+        if (next() != static_cast<uint8_t>(c))
+            throw Error("Not a trace file: " + path);
+    }
+
+    const size_t dim = next();
+    bufferSize_      = next();
+    matrix_.resize(dim);
+    for (auto& row : matrix_) {
+        for (size_t x = 0; x < dim; x++)
+            row.push_back(next());
+    }
+    goals_.resize(next());
+    for (auto& goal : goals_) {
+        for (size_t len = next(); len > 0; len--)
+            goal.push_back(next());
+    }
+
+    const long header = ftell(file);
+    if (fseek(file, 0, SEEK_END) == 0) {
+        events_.reserve(static_cast<size_t>(ftell(file) - header));
+        fseek(file, header, SEEK_SET);
+    }
+
+    eventsByDepth_.resize(bufferSize_ + 1);
+    cellsByDepth_.assign(bufferSize_ + 1, vector<size_t>(dim * dim));
+    uint8_t chunk[4096];
+    for (size_t read; (read = fread(chunk, 2, sizeof(chunk) / 2, file)) > 0;) {
+        for (size_t i = 0; i < read * 2; i += 2) {
+            const auto step = TraceStep::decode(chunk[i], chunk[i + 1]);
+            if (step.depth_ == 0 || step.depth_ > bufferSize_ || step.point_.x_ >= dim ||
+                step.point_.y_ >= dim)
+                throw Error("Trace file is corrupt");
+            eventsByDepth_[step.depth_][static_cast<size_t>(step.event_)]++;
+            if (step.event_ != TraceEvent::Winner)
+                cellsByDepth_[step.depth_][step.point_.y_ * dim + step.point_.x_]++;
+        }
+        events_.insert(events_.end(), chunk, chunk + read * 2);
+    }
+}
+
+Sequence
+TraceFile::sequenceAt(size_t index) const noexcept
+{
+    Sequence sequence{};
+    if (index >= size())
+        return sequence;
+
+    // The search is depth first, so each ancestor is the most recent earlier
+    // event one level shallower than the node we last found.
+    size_t depth = step(index).depth_;
+    sequence.resize(depth);
+    for (size_t i = index + 1; i-- > 0 && depth > 0;) {
+        const auto earlier = step(i);
+        if (earlier.depth_ == depth) {
+            sequence[depth - 1] = earlier.point_;
+            --depth;
+        }
+    }
+    return sequence;
+}
@@ -0,0 +1,122 @@
+// CyberPunk ICE/Hack solver
+// Copyright (C) Oliver "kfsone" Smith <oliver@kfs.org> 2021
+
+#pragma once
+
+#include "cyberhack.h"
+
+#include <array>
+#include <cstdio>
+#include <string>
+#include <utility>
+
+// TraceEvent describes what the search did with a single node.
+enum class TraceEvent : uint8_t
+{
+    Expand,  // node was scored and its children queued
+    Leaf,    // node was scored but the buffer or goals were exhausted
+    Prune,   // node was cut because it could not beat the winner
+    Winner,  // node became the new winner
+};
+
+// SearchTrace streams search events to a compact binary file.
+//
+// Each event is two bytes: the event kind and depth, then the x/y of the last
+// move. The rest of the node's sequence is implied by the search being depth
+// first: a node's ancestors are the most recent earlier events at each
+// shallower depth. The buffer belongs to the thread running the search, so
+// recording takes no locks, and Hack only pays for a null check when tracing
+// is disabled.
+struct SearchTrace final
+{
+    static constexpr char   Magic[4] = {'C', 'H', 'T', '1'};
+    static constexpr size_t MaxDim   = 16;
+    static constexpr size_t MaxDepth = 63;
+
+    SearchTrace(std::string path) noexcept : path_{std::move(path)} {}
+    ~SearchTrace() { end(); }
+
+    SearchTrace(const SearchTrace&) = delete;
+    SearchTrace& operator=(const SearchTrace&) = delete;
+
+    // Opens the trace file and writes the puzzle being solved. Puzzles that
+    // can't be traced are logged and leave the trace closed.
+    void begin(const Matrix& matrix, const Matrix& goals, size_t bufferSize) noexcept;
+
+    // Flushes outstanding events and closes the file.
+    void end() noexcept;
+
+    void record(TraceEvent event, size_t depth, Point point) noexcept
+    {
+        if (used_ + 2 > buffer_.size())
+            flush();
+        buffer_[used_++] = static_cast<uint8_t>((static_cast<uint8_t>(event) << 6) | depth);
+        buffer_[used_++] = static_cast<uint8_t>((point.x_ << 4) | point.y_);
+    }
+
+    // Closes the trace and forgets whether anything was recorded.
+    void reset() noexcept
+    {
+        end();
+        recorded_ = false;
+    }
+
+    bool recording() const noexcept { return file_ != nullptr; }
+
+    // True if the last begin() opened a new trace file.
+    bool recorded() const noexcept { return recorded_; }
+
+    const std::string& path() const noexcept { return path_; }
+
+protected:
+    void flush() noexcept;
+
+    std::string                 path_;
+    FILE*                       file_{nullptr};
+    bool                        recorded_{false};
+    size_t                      used_{0};
+    std::array<uint8_t, 65536>  buffer_{};
+};
+
+// TraceStep is a decoded SearchTrace event.
+struct TraceStep final
+{
+    TraceEvent event_;
+    size_t     depth_;
+    Point      point_;
+
+    static constexpr TraceStep decode(uint8_t head, uint8_t move) noexcept
+    {
+        return TraceStep{static_cast<TraceEvent>(head >> 6), size_t(head & 0x3f),
+                         Point{size_t(move >> 4), size_t(move & 0xf)}};
+    }
+};
+
+// TraceFile is a SearchTrace loaded back for replay.
+struct TraceFile final
+{
+    size_t bufferSize_{0};
+    Matrix matrix_{};
+    Matrix goals_{};
+
+    // The events exactly as recorded, two bytes each; see SearchTrace.
+    vector<uint8_t> events_{};
+
+    // Per depth, how many of each kind of event were recorded.
+    vector<std::array<size_t, 4>> eventsByDepth_{};
+    // Per depth, how many nodes landed on each cell (y * dim + x).
+    vector<vector<size_t>> cellsByDepth_{};
+
+    // Reads the trace in one pass, counting events as they stream in.
+    void load(const std::string& path) noexcept(false);
+
+    size_t size() const noexcept { return events_.size() / 2; }
+
+    TraceStep step(size_t index) const noexcept
+    {
+        return TraceStep::decode(events_[index * 2], events_[index * 2 + 1]);
+    }
+
+    // Reconstructs the full sequence of the node recorded at 'index'.
+    Sequence sequenceAt(size_t index) const noexcept;
+};